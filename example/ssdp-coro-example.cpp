@@ -0,0 +1,61 @@
+#include "../ssdp-connect.hpp"
+#include <cstdio>
+#include <cstring>
+
+/* Server and client running as coroutines on one thread */
+
+static const char service_type[] = "someservice:type";
+
+static ssdp::task server_task(ssdp::reactor& r) {
+	ssdp::socket ssdp_sock = ssdp::socket::multicast();
+	ssdp::socket server = ssdp::socket::udp();
+	std::printf("Server on port %hu\n", server.port());
+
+	auto handshakes = ssdp::listen(r, ssdp_sock, server, service_type, "id:123456", "Coroutine example");
+	while (const ssdp::datagram* d = co_await handshakes.next()) {
+		if (d->data.size() >= 12 && std::memcmp(d->data.data(), "Hello world!", 12) == 0) {
+			std::printf("Connection established with %s:%hu!\n", inet_ntoa(d->from.sin_addr), ntohs(d->from.sin_port));
+			break;
+		}
+	}
+}
+
+static ssdp::task client_task(ssdp::reactor& r) {
+	ssdp::socket client = ssdp::socket::udp();
+	std::printf("Client on port %hu\n", client.port());
+
+	auto servers = ssdp::scan(r, client, service_type, std::chrono::milliseconds(1000), 3);
+	while (const ssdp::scan_result* s = co_await servers.next()) {
+		std::printf("Found %.*s (%.*s)\n", (int)s->service_name.size(), s->service_name.data(),
+			(int)s->user_agent.size(), s->user_agent.data());
+		const ssdp_transport* t = ssdp_default_transport();
+		t->send(t->ctx, client.native(), "Hello world!", 12, &s->server);
+		co_return;
+	}
+	std::printf("No servers found.\n");
+}
+
+int main() {
+#ifdef SSDP_PLATFORM_WINDOWS
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData)) {
+		std::printf("Failed to init WinSock2\n");
+		return 1;
+	}
+#endif
+
+	try {
+		ssdp::reactor r;
+		r.spawn(server_task(r));
+		r.spawn(client_task(r));
+		r.run();
+	}
+	catch (const std::exception& e) {
+		std::printf("Error: %s\n", e.what());
+	}
+
+#ifdef SSDP_PLATFORM_WINDOWS
+	WSACleanup();
+#endif
+	return 0;
+}
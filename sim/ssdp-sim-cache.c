@@ -0,0 +1,294 @@
+#include "ssdp-sim.h"
+#include "../ssdp-cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Checks of ssdp-cache.h: file reinitialization, eviction, scan order and stale cutoff,
+ * removal from scan callback and revalidation on simulated network with some servers missing.
+ * Prints failed checks, returns 0 if all of them passed.
+ * Usage: ssdp-sim-cache [cache_file] */
+
+static const char service_type[] = "someservice:type";
+static const char* cache_path = "ssdp-sim-cache.tmp";
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+#define MAX_RECORDS 16
+
+/* Servers reported to callback */
+struct record {
+	int count;
+	char name[MAX_RECORDS][32];
+	SSDP_CACHE_STATUS status[MAX_RECORDS];
+	struct sockaddr_in server[MAX_RECORDS];
+	struct ssdp_cache* remove_from;  /* remove reported entries from this cache */
+	int stop;                        /* value returned from callback */
+};
+
+static int record_callback(const char* service_name, const char* user_agent, const struct sockaddr_in* server,
+	SSDP_CACHE_STATUS status, void* param) {
+	struct record* r = (struct record*)param;
+	if (r->count < MAX_RECORDS) {
+		snprintf(r->name[r->count], sizeof(r->name[0]), "%s", service_name);
+		r->status[r->count] = status;
+		r->server[r->count] = *server;
+		++r->count;
+	}
+	if (r->remove_from)
+		ssdp_cache_remove(r->remove_from, service_name);
+	return r->stop;
+}
+
+/* Returns index of record of <name> with <status>, -1 if not reported */
+static int find_record(const struct record* r, const char* name, SSDP_CACHE_STATUS status) {
+	for (int i = 0; i < r->count; ++i)
+		if (strcmp(r->name[i], name) == 0 && r->status[i] == status)
+			return i;
+	return -1;
+}
+
+/* Host address 10.x.x.x for index <i> */
+static void host_address(struct sockaddr_in* addr, int i, unsigned short port) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(0x0A000000u + (unsigned int)i + 1);
+	addr->sin_port = htons(port);
+}
+
+/* Address of virtual server "sim:<i>" */
+static void server_address(struct sockaddr_in* addr, int i) {
+	host_address(addr, i + 1, 40000);
+}
+
+static struct ssdp_cache_entry* find_entry(struct ssdp_cache* cache, const char* name) {
+	for (uint32_t i = 0; i < cache->header->count; ++i)
+		if (strcmp(cache->entries[i].service_name, name) == 0)
+			return &cache->entries[i];
+	return NULL;
+}
+
+/* Add entry of "sim:<i>" last seen <age> seconds ago */
+static void add_entry(struct ssdp_cache* cache, const char* type, int i, long age) {
+	char name[32];
+	struct sockaddr_in addr;
+	snprintf(name, sizeof(name), "sim:%d", i);
+	server_address(&addr, i);
+	ssdp_cache_update(cache, type, name, "sim-server", &addr, SSDP_CACHE_MAX_AGE);
+	find_entry(cache, name)->last_seen -= age;
+}
+
+static int open_new_cache(struct ssdp_cache* cache, int capacity) {
+	remove(cache_path);
+	return ssdp_cache_open(cache, cache_path, capacity);
+}
+
+/* Cache file */
+
+static void check_file(void) {
+	struct ssdp_cache cache;
+
+	/* garbage is replaced with an empty cache */
+	FILE* f = fopen(cache_path, "wb");
+	CHECK(f != NULL);
+	if (f == NULL)
+		return;
+	for (int i = 0; i < 1000; ++i)
+		fputc(i * 7, f);
+	fclose(f);
+	CHECK(ssdp_cache_open(&cache, cache_path, 3) == 0);
+	CHECK(cache.header->capacity == 3 && cache.header->count == 0);
+	add_entry(&cache, service_type, 0, 0);
+	ssdp_cache_close(&cache);
+
+	/* valid file is kept as is */
+	CHECK(ssdp_cache_open(&cache, cache_path, 10) == 0);
+	CHECK(cache.header->capacity == 3 && cache.header->count == 1);
+	CHECK(find_entry(&cache, "sim:0") != NULL);
+	ssdp_cache_close(&cache);
+
+	/* file of other version is reinitialized */
+	f = fopen(cache_path, "r+b");
+	CHECK(f != NULL);
+	if (f == NULL)
+		return;
+	struct ssdp_cache_header header;
+	CHECK(fread(&header, sizeof(header), 1, f) == 1);
+	header.version = SSDP_CACHE_VERSION + 1;
+	fseek(f, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, f);
+	fclose(f);
+	CHECK(ssdp_cache_open(&cache, cache_path, 5) == 0);
+	CHECK(cache.header->capacity == 5 && cache.header->count == 0);
+	ssdp_cache_close(&cache);
+}
+
+/* Eviction, scan order, stale cutoff and removal from callback */
+
+static void check_scan(void) {
+	struct ssdp_cache cache;
+	struct record r;
+	CHECK(open_new_cache(&cache, 3) == 0);
+
+	/* the entry which expires first is replaced when cache is full */
+	add_entry(&cache, service_type, 0, 0);
+	add_entry(&cache, service_type, 1, 50);
+	add_entry(&cache, service_type, 2, 10);
+	add_entry(&cache, service_type, 3, 0);
+	CHECK(cache.header->count == 3);
+	CHECK(find_entry(&cache, "sim:1") == NULL);
+	ssdp_cache_close(&cache);
+
+	CHECK(open_new_cache(&cache, 8) == 0);
+	add_entry(&cache, service_type, 0, SSDP_CACHE_MAX_AGE + 100);   /* stale */
+	add_entry(&cache, service_type, 1, 0);                          /* fresh */
+	add_entry(&cache, service_type, 2, SSDP_CACHE_MAX_AGE + 5000);  /* stale, old */
+	add_entry(&cache, "otherservice:type", 3, 0);                   /* other service type */
+
+	/* fresh first, then stale within horizon */
+	memset(&r, 0, sizeof(r));
+	CHECK(ssdp_cache_scan(&cache, service_type, sizeof(service_type) - 1, 1000, record_callback, &r) == 0);
+	CHECK(r.count == 2);
+	CHECK(find_record(&r, "sim:1", SSDP_CACHE_FRESH) == 0);
+	CHECK(find_record(&r, "sim:0", SSDP_CACHE_STALE) == 1);
+
+	/* no horizon */
+	memset(&r, 0, sizeof(r));
+	ssdp_cache_scan(&cache, service_type, sizeof(service_type) - 1, -1, record_callback, &r);
+	CHECK(r.count == 3);
+	CHECK(find_record(&r, "sim:2", SSDP_CACHE_STALE) == 2);
+
+	/* callback stops scan */
+	memset(&r, 0, sizeof(r));
+	r.stop = 1;
+	CHECK(ssdp_cache_scan(&cache, service_type, sizeof(service_type) - 1, -1, record_callback, &r) == 1);
+	CHECK(r.count == 1);
+
+	/* callback removes every reported entry, all of them are still reported */
+	add_entry(&cache, service_type, 4, 0);
+	add_entry(&cache, service_type, 5, 0);
+	memset(&r, 0, sizeof(r));
+	r.remove_from = &cache;
+	ssdp_cache_scan(&cache, service_type, sizeof(service_type) - 1, -1, record_callback, &r);
+	CHECK(r.count == 5);
+	CHECK(find_record(&r, "sim:4", SSDP_CACHE_FRESH) != -1 && find_record(&r, "sim:5", SSDP_CACHE_FRESH) != -1);
+	CHECK(cache.header->count == 1 && find_entry(&cache, "sim:3") != NULL);
+
+	ssdp_cache_close(&cache);
+}
+
+/* Revalidation on simulated network */
+
+struct virtual_server {
+	ssdp_socket_t server;
+	char name[32];
+};
+
+static void virtual_server_handler(struct ssdp_sim* sim, ssdp_socket_t s, const char* data, int size,
+	const struct sockaddr_in* from, void* param) {
+	struct virtual_server* vs = (struct virtual_server*)param;
+	ssdp_listen_handle(ssdp_sim_transport(sim), vs->server, service_type, sizeof(service_type) - 1,
+		vs->name, "sim-server", data, size, from);
+}
+
+/* Network of virtual servers "sim:<ids[i]>" and client, returns client socket or -1 on error */
+static ssdp_socket_t create_network(struct ssdp_sim* sim, struct virtual_server* servers, const int* ids, int count) {
+	struct sockaddr_in addr;
+	for (int i = 0; i < count; ++i) {
+		host_address(&addr, ids[i] + 1, SSDP_PORT);
+		ssdp_socket_t ssdp_sock = ssdp_sim_socket(sim, &addr, 1);
+		server_address(&addr, ids[i]);
+		servers[i].server = ssdp_sim_socket(sim, &addr, 0);
+		if (ssdp_sock == -1 || servers[i].server == -1)
+			return -1;
+		snprintf(servers[i].name, sizeof(servers[i].name), "sim:%d", ids[i]);
+		ssdp_sim_set_handler(sim, ssdp_sock, virtual_server_handler, &servers[i]);
+	}
+	host_address(&addr, 0, 50000);
+	return ssdp_sim_socket(sim, &addr, 0);
+}
+
+static int failing_send(void* ctx, ssdp_socket_t s, const char* data, int size, const struct sockaddr_in* to) {
+	return -1;
+}
+
+static void check_revalidate(void) {
+	static const int ids[] = { 0, 1, 2, 5 };
+	struct virtual_server servers[4];
+	struct ssdp_sim_config config = { 1, 20, 0, 65536, 1 };
+	struct ssdp_sim* sim = ssdp_sim_create(&config);
+	CHECK(sim != NULL);
+	if (sim == NULL)
+		return;
+	ssdp_socket_t client = create_network(sim, servers, ids, 4);
+	CHECK(client != -1);
+
+	struct ssdp_cache cache;
+	struct record r;
+	CHECK(open_new_cache(&cache, 8) == 0);
+	add_entry(&cache, service_type, 0, 0);                        /* fresh, responds */
+	add_entry(&cache, service_type, 1, 0);                        /* fresh, responds from other address */
+	find_entry(&cache, "sim:1")->port = htons(1);
+	add_entry(&cache, service_type, 2, SSDP_CACHE_MAX_AGE + 100);  /* stale, responds */
+	add_entry(&cache, service_type, 3, SSDP_CACHE_MAX_AGE + 100);  /* stale, missing */
+	add_entry(&cache, service_type, 4, 0);                        /* fresh, missing */
+
+	/* every send fails: nothing is removed */
+	struct ssdp_transport failing = *ssdp_sim_transport(sim);
+	failing.send = failing_send;
+	memset(&r, 0, sizeof(r));
+	CHECK(ssdp_cache_revalidate_ex(&failing, client, &cache, service_type, sizeof(service_type) - 1,
+		500, 2, record_callback, &r) < 0);
+	CHECK(r.count == 0 && cache.header->count == 5);
+
+	/* cached servers are reported first, then revalidation results */
+	memset(&r, 0, sizeof(r));
+	CHECK(ssdp_scan_cached_ex(ssdp_sim_transport(sim), client, &cache, service_type, sizeof(service_type) - 1,
+		-1, 500, 2, record_callback, &r) == 0);
+	CHECK(find_record(&r, "sim:0", SSDP_CACHE_FRESH) != -1 && find_record(&r, "sim:0", SSDP_CACHE_FOUND) == -1);
+	CHECK(find_record(&r, "sim:1", SSDP_CACHE_FRESH) != -1);
+	CHECK(find_record(&r, "sim:2", SSDP_CACHE_STALE) != -1);
+	CHECK(find_record(&r, "sim:3", SSDP_CACHE_STALE) != -1);
+	CHECK(find_record(&r, "sim:4", SSDP_CACHE_FRESH) != -1);
+	CHECK(find_record(&r, "sim:1", SSDP_CACHE_FOUND) != -1);  /* moved */
+	CHECK(find_record(&r, "sim:2", SSDP_CACHE_FOUND) != -1);  /* stale */
+	CHECK(find_record(&r, "sim:5", SSDP_CACHE_FOUND) != -1);  /* new */
+	CHECK(find_record(&r, "sim:3", SSDP_CACHE_GONE) != -1);
+	CHECK(find_record(&r, "sim:4", SSDP_CACHE_GONE) == -1);
+	CHECK(r.count == 9);
+	CHECK(cache.header->count == 5 && find_entry(&cache, "sim:3") == NULL && find_entry(&cache, "sim:4") != NULL);
+	CHECK(find_entry(&cache, "sim:1") && find_entry(&cache, "sim:1")->port == htons(40000));
+
+	/* callback stopping on a cached server skips revalidation */
+	memset(&r, 0, sizeof(r));
+	r.stop = 1;
+	CHECK(ssdp_scan_cached_ex(ssdp_sim_transport(sim), client, &cache, service_type, sizeof(service_type) - 1,
+		-1, 500, 2, record_callback, &r) == 1);
+	CHECK(r.count == 1);
+	ssdp_cache_close(&cache);
+
+	/* cache is not open: plain scan */
+	CHECK(ssdp_cache_open(&cache, "", 8) == -1);
+	memset(&r, 0, sizeof(r));
+	CHECK(ssdp_scan_cached_ex(ssdp_sim_transport(sim), client, &cache, service_type, sizeof(service_type) - 1,
+		-1, 500, 1, record_callback, &r) == 0);
+	CHECK(r.count == 4);
+	for (int i = 0; i < 4; ++i)
+		CHECK(find_record(&r, servers[i].name, SSDP_CACHE_FOUND) != -1);
+
+	ssdp_sim_destroy(sim);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1)
+		cache_path = argv[1];
+
+	check_file();
+	check_scan();
+	check_revalidate();
+	remove(cache_path);
+
+	printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,202 @@
+#include "ssdp-sim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Scaling test of ssdp_scan_ex() and ssdp_listen_ex() on simulated network.
+ * Runs scanner against growing number of virtual servers and server against growing number of virtual clients,
+ * reports discovery completeness and virtual time to complete.
+ * Usage: ssdp-sim-scale [latency_msec] [jitter_msec] [loss] [rcvbuf] */
+
+static const char service_type[] = "someservice:type";
+static const int counts[] = { 1, 10, 100, 1000, 5000 };
+
+#define DISCOVER_PERIOD_MSEC 1000
+#define DISCOVER_RETRIES 3
+
+/* Host address 10.x.x.x for index <i> */
+static void host_address(struct sockaddr_in* addr, int i, unsigned short port) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(0x0A000000u + (unsigned int)i + 1);
+	addr->sin_port = htons(port);
+}
+
+/* Scan */
+
+struct virtual_server {
+	ssdp_socket_t server;
+	char name[32];
+};
+
+struct scan_state {
+	struct ssdp_sim* sim;
+	int count;
+	char* found;
+	int found_count;
+	long long complete_time;
+};
+
+static void virtual_server_handler(struct ssdp_sim* sim, ssdp_socket_t s, const char* data, int size,
+	const struct sockaddr_in* from, void* param) {
+	struct virtual_server* vs = (struct virtual_server*)param;
+	ssdp_listen_handle(ssdp_sim_transport(sim), vs->server, service_type, sizeof(service_type) - 1,
+		vs->name, "sim-server", data, size, from);
+}
+
+static int scan_callback(const char* service_name, const char* user_agent, const struct sockaddr_in* server, void* param) {
+	struct scan_state* state = (struct scan_state*)param;
+	if (strncmp(service_name, "sim:", 4) != 0)
+		return 0;
+	int i = atoi(service_name + 4);
+	if (i >= 0 && i < state->count && !state->found[i]) {
+		state->found[i] = 1;
+		++state->found_count;
+		state->complete_time = ssdp_sim_time(state->sim);
+	}
+	return 0;
+}
+
+static int run_scan(const struct ssdp_sim_config* config, int count) {
+	struct ssdp_sim* sim = ssdp_sim_create(config);
+	struct virtual_server* servers = (struct virtual_server*)calloc(count, sizeof(struct virtual_server));
+	struct scan_state state = { sim, count, (char*)calloc(count, 1), 0, -1 };
+	int result = -1;
+	if (sim == NULL || servers == NULL || state.found == NULL)
+		goto End;
+
+	struct sockaddr_in addr;
+	for (int i = 0; i < count; ++i) {
+		host_address(&addr, i + 1, SSDP_PORT);
+		ssdp_socket_t ssdp_sock = ssdp_sim_socket(sim, &addr, 1);
+		host_address(&addr, i + 1, 40000);
+		servers[i].server = ssdp_sim_socket(sim, &addr, 0);
+		if (ssdp_sock == -1 || servers[i].server == -1)
+			goto End;
+		snprintf(servers[i].name, sizeof(servers[i].name), "sim:%d", i);
+		ssdp_sim_set_handler(sim, ssdp_sock, virtual_server_handler, &servers[i]);
+	}
+	host_address(&addr, 0, 50000);
+	ssdp_socket_t client = ssdp_sim_socket(sim, &addr, 0);
+	if (client == -1)
+		goto End;
+
+	ssdp_scan_ex(ssdp_sim_transport(sim), client, service_type, sizeof(service_type) - 1,
+		DISCOVER_PERIOD_MSEC, DISCOVER_RETRIES, scan_callback, &state);
+
+	struct ssdp_sim_stats stats;
+	ssdp_sim_stats(sim, &stats);
+	printf("%8d %8d %8.2f%% %12lld %8ld %10ld\n", count, state.found_count, state.found_count * 100.0 / count,
+		state.complete_time, stats.lost, stats.overflowed);
+	result = 0;
+
+End:
+	free(state.found);
+	free(servers);
+	ssdp_sim_destroy(sim);
+	return result;
+}
+
+/* Listen */
+
+struct listen_state {
+	struct ssdp_sim* sim;
+	int count;
+	int handshakes;
+	long long complete_time;
+};
+
+/* Virtual client sends handshake to every server that responded */
+static void virtual_client_handler(struct ssdp_sim* sim, ssdp_socket_t s, const char* data, int size,
+	const struct sockaddr_in* from, void* param) {
+	SSDP_REQUEST_TYPE type = SSDP_RT_NONE;
+	if (ssdp_parse_request(data, size, &type, NULL, 0, NULL, 0, NULL, 0) > 0 && type == SSDP_RT_RESPONSE) {
+		const struct ssdp_transport* t = ssdp_sim_transport(sim);
+		t->send(t->ctx, s, "Hello world!", 12, from);
+	}
+}
+
+static int listen_callback(const char* data, int size, const struct sockaddr_in* client, void* param) {
+	struct listen_state* state = (struct listen_state*)param;
+	if (size >= 12 && memcmp(data, "Hello world!", 12) == 0) {
+		state->complete_time = ssdp_sim_time(state->sim);
+		return ++state->handshakes == state->count;
+	}
+	return 0;
+}
+
+static int run_listen(const struct ssdp_sim_config* config, int count) {
+	struct ssdp_sim* sim = ssdp_sim_create(config);
+	if (sim == NULL)
+		return -1;
+	const struct ssdp_transport* t = ssdp_sim_transport(sim);
+	struct listen_state state = { sim, count, 0, -1 };
+	int result = -1;
+
+	struct sockaddr_in addr;
+	host_address(&addr, 0, SSDP_PORT);
+	ssdp_socket_t ssdp_sock = ssdp_sim_socket(sim, &addr, 1);
+	host_address(&addr, 0, 40000);
+	ssdp_socket_t server = ssdp_sim_socket(sim, &addr, 0);
+	if (ssdp_sock == -1 || server == -1)
+		goto End;
+
+	/* every client sends one ssdp:discover at the start */
+	char buffer[512];
+	int size = ssdp_discover(service_type, buffer, sizeof(buffer));
+	struct sockaddr_in ssdp_addr;
+	ssdp_address(&ssdp_addr);
+	for (int i = 0; i < count; ++i) {
+		host_address(&addr, i + 1, 50000);
+		ssdp_socket_t client = ssdp_sim_socket(sim, &addr, 0);
+		if (client == -1)
+			goto End;
+		ssdp_sim_set_handler(sim, client, virtual_client_handler, NULL);
+		t->send(t->ctx, client, buffer, size, &ssdp_addr);
+	}
+
+	/* returns when all handshakes are received or there is nothing left to receive */
+	ssdp_listen_ex(t, ssdp_sock, server, service_type, sizeof(service_type) - 1,
+		"sim:server", "sim-server", listen_callback, &state);
+
+	struct ssdp_sim_stats stats;
+	ssdp_sim_stats(sim, &stats);
+	printf("%8d %8d %8.2f%% %12lld %8ld %10ld\n", count, state.handshakes, state.handshakes * 100.0 / count,
+		state.complete_time, stats.lost, stats.overflowed);
+	result = 0;
+
+End:
+	ssdp_sim_destroy(sim);
+	return result;
+}
+
+int main(int argc, char** argv) {
+	struct ssdp_sim_config config = {
+		.latency_msec = 1,
+		.jitter_msec = 50,
+		.loss = 0.01,
+		.rcvbuf = 212992,
+		.seed = 1
+	};
+	if (argc > 1) config.latency_msec = atol(argv[1]);
+	if (argc > 2) config.jitter_msec = atol(argv[2]);
+	if (argc > 3) config.loss = atof(argv[3]);
+	if (argc > 4) config.rcvbuf = atoi(argv[4]);
+
+	printf("latency %ld msec, jitter %ld msec, loss %.3f, rcvbuf %d bytes\n",
+		config.latency_msec, config.jitter_msec, config.loss, config.rcvbuf);
+
+	printf("\nssdp_scan: %d retries every %d msec\n", DISCOVER_RETRIES, DISCOVER_PERIOD_MSEC);
+	printf("%8s %8s %9s %12s %8s %10s\n", "servers", "found", "complete", "time_msec", "lost", "overflowed");
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+		if (run_scan(&config, counts[i]) == -1)
+			return 1;
+
+	printf("\nssdp_listen: one ssdp:discover per client\n");
+	printf("%8s %8s %9s %12s %8s %10s\n", "clients", "connected", "complete", "time_msec", "lost", "overflowed");
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+		if (run_listen(&config, counts[i]) == -1)
+			return 1;
+
+	return 0;
+}
@@ -0,0 +1,343 @@
+#include "ssdp-sim.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* number of buckets in address hash table */
+#define SIM_BUCKETS 4096
+
+/* Datagram in flight or in socket's receive queue */
+struct sim_datagram {
+	long long time;             /* arrival time */
+	unsigned long seq;          /* send order, to keep delivery deterministic */
+	ssdp_socket_t to;
+	struct sockaddr_in from;
+	struct sim_datagram* next;  /* next datagram in receive queue */
+	int size;
+	char data[];
+};
+
+struct sim_socket {
+	struct sockaddr_in addr;
+	int multicast;
+	pf_ssdp_sim_handler handler;
+	void* param;
+	struct sim_datagram* head;  /* receive queue */
+	struct sim_datagram* tail;
+	int queued;                 /* bytes in receive queue */
+	int next;                   /* next socket in the same hash bucket, -1 if none */
+};
+
+struct ssdp_sim {
+	struct ssdp_sim_config config;
+	struct ssdp_transport transport;
+	struct ssdp_sim_stats stats;
+	long long time;
+	unsigned long seq;
+	unsigned long long random;
+
+	struct sim_socket* sockets;
+	int socket_count, socket_capacity;
+
+	/* multicast group members */
+	ssdp_socket_t* members;
+	int member_count, member_capacity;
+
+	/* datagrams in flight, min-heap by arrival time */
+	struct sim_datagram** heap;
+	int heap_count, heap_capacity;
+
+	int buckets[SIM_BUCKETS];
+};
+
+/* Grow array <*p> of <*capacity> elements to hold at least <count> elements */
+static int grow(void** p, int* capacity, int count, size_t elem_size) {
+	if (count <= *capacity)
+		return 0;
+	int new_capacity = *capacity ? *capacity * 2 : 64;
+	void* new_p = realloc(*p, new_capacity * elem_size);
+	if (new_p == NULL)
+		return -1;
+	*p = new_p;
+	*capacity = new_capacity;
+	return 0;
+}
+
+/* xorshift64*, returns number in [0, 1) */
+static double sim_random(struct ssdp_sim* sim) {
+	sim->random ^= sim->random >> 12;
+	sim->random ^= sim->random << 25;
+	sim->random ^= sim->random >> 27;
+	return (double)((sim->random * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+inline static unsigned int addr_hash(const struct sockaddr_in* addr) {
+	return (ntohl(addr->sin_addr.s_addr) * 31u + ntohs(addr->sin_port)) % SIM_BUCKETS;
+}
+
+static ssdp_socket_t find_socket(const struct ssdp_sim* sim, const struct sockaddr_in* addr) {
+	for (int i = sim->buckets[addr_hash(addr)]; i != -1; i = sim->sockets[i].next)
+		if (sim->sockets[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr && sim->sockets[i].addr.sin_port == addr->sin_port)
+			return i;
+	return -1;
+}
+
+inline static int valid_socket(const struct ssdp_sim* sim, ssdp_socket_t s) {
+	return s >= 0 && s < sim->socket_count;
+}
+
+/* Heap of datagrams in flight */
+
+inline static int heap_less(const struct sim_datagram* a, const struct sim_datagram* b) {
+	return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+static int heap_push(struct ssdp_sim* sim, struct sim_datagram* dg) {
+	if (grow((void**)&sim->heap, &sim->heap_capacity, sim->heap_count + 1, sizeof(*sim->heap)) == -1)
+		return -1;
+	int i = sim->heap_count++;
+	while (i > 0 && heap_less(dg, sim->heap[(i - 1) / 2])) {
+		sim->heap[i] = sim->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	sim->heap[i] = dg;
+	return 0;
+}
+
+static struct sim_datagram* heap_pop(struct ssdp_sim* sim) {
+	struct sim_datagram* top = sim->heap[0];
+	struct sim_datagram* last = sim->heap[--sim->heap_count];
+	int i = 0;
+	for (;;) {
+		int child = i * 2 + 1;
+		if (child >= sim->heap_count)
+			break;
+		if (child + 1 < sim->heap_count && heap_less(sim->heap[child + 1], sim->heap[child]))
+			++child;
+		if (!heap_less(sim->heap[child], last))
+			break;
+		sim->heap[i] = sim->heap[child];
+		i = child;
+	}
+	if (sim->heap_count)
+		sim->heap[i] = last;
+	return top;
+}
+
+/* Put datagram in flight from socket <s> to socket <to> */
+static void schedule(struct ssdp_sim* sim, ssdp_socket_t s, ssdp_socket_t to, const char* data, int size) {
+	if (sim->config.loss > 0 && sim_random(sim) < sim->config.loss) {
+		++sim->stats.lost;
+		return;
+	}
+
+	struct sim_datagram* dg = (struct sim_datagram*)malloc(sizeof(struct sim_datagram) + size);
+	if (dg == NULL)
+		return;
+	dg->time = sim->time + sim->config.latency_msec;
+	if (sim->config.jitter_msec > 0)
+		dg->time += (long long)(sim_random(sim) * (sim->config.jitter_msec + 1));
+	dg->seq = sim->seq++;
+	dg->to = to;
+	dg->from = sim->sockets[s].addr;
+	dg->next = NULL;
+	dg->size = size;
+	memcpy(dg->data, data, size);
+	if (heap_push(sim, dg) == -1)
+		free(dg);
+}
+
+/* Deliver the earliest datagram in flight, advancing virtual time */
+static void deliver_next(struct ssdp_sim* sim) {
+	struct sim_datagram* dg = heap_pop(sim);
+	if (dg->time > sim->time)
+		sim->time = dg->time;
+
+	struct sim_socket* sock = &sim->sockets[dg->to];
+	if (sock->handler) {
+		++sim->stats.delivered;
+		/* handler may create sockets and invalidate <sock> */
+		sock->handler(sim, dg->to, dg->data, dg->size, &dg->from, sock->param);
+		free(dg);
+	}
+	else if (sock->queued + dg->size > sim->config.rcvbuf) {
+		++sim->stats.overflowed;
+		free(dg);
+	}
+	else {
+		++sim->stats.delivered;
+		if (sock->tail)
+			sock->tail->next = dg;
+		else
+			sock->head = dg;
+		sock->tail = dg;
+		sock->queued += dg->size;
+	}
+}
+
+/* Transport */
+
+static int sim_send(void* ctx, ssdp_socket_t s, const char* data, int size, const struct sockaddr_in* to) {
+	struct ssdp_sim* sim = (struct ssdp_sim*)ctx;
+	if (!valid_socket(sim, s) || size < 0)
+		return -1;
+	++sim->stats.sent;
+
+	struct sockaddr_in ssdp_addr;
+	ssdp_address(&ssdp_addr);
+	if (to->sin_addr.s_addr == ssdp_addr.sin_addr.s_addr && to->sin_port == ssdp_addr.sin_port) {
+		for (int i = 0; i < sim->member_count; ++i)
+			if (sim->members[i] != s)
+				schedule(sim, s, sim->members[i], data, size);
+	}
+	else {
+		ssdp_socket_t dest = find_socket(sim, to);
+		if (dest == -1)
+			++sim->stats.unreachable;
+		else
+			schedule(sim, s, dest, data, size);
+	}
+	return size;
+}
+
+static int sim_recv(void* ctx, ssdp_socket_t s, char* buffer, int size, struct sockaddr_in* from) {
+	struct ssdp_sim* sim = (struct ssdp_sim*)ctx;
+	if (!valid_socket(sim, s) || sim->sockets[s].head == NULL)
+		return -1;
+
+	struct sim_socket* sock = &sim->sockets[s];
+	struct sim_datagram* dg = sock->head;
+	sock->head = dg->next;
+	if (sock->head == NULL)
+		sock->tail = NULL;
+	sock->queued -= dg->size;
+
+	/* excess data is discarded, like with real UDP sockets */
+	int result = dg->size < size ? dg->size : size;
+	memcpy(buffer, dg->data, result);
+	if (from)
+		*from = dg->from;
+	free(dg);
+	return result;
+}
+
+static int sim_wait(void* ctx, const ssdp_socket_t* sockets, int* readable, int count, long timeout_msec) {
+	struct ssdp_sim* sim = (struct ssdp_sim*)ctx;
+	long long deadline = timeout_msec < 0 ? -1 : sim->time + timeout_msec;
+
+	for (;;) {
+		/* deliver everything that has already arrived, so simultaneous datagrams may overflow receive buffer */
+		while (sim->heap_count && sim->heap[0]->time <= sim->time)
+			deliver_next(sim);
+
+		int result = 0;
+		for (int i = 0; i < count; ++i) {
+			readable[i] = valid_socket(sim, sockets[i]) && sim->sockets[sockets[i]].head != NULL;
+			result += readable[i];
+		}
+		if (result)
+			return result;
+
+		if (sim->heap_count == 0 || (deadline >= 0 && sim->heap[0]->time > deadline)) {
+			/* nothing will ever arrive, waiting forever would hang */
+			if (deadline < 0)
+				return -1;
+			sim->time = deadline;
+			return 0;
+		}
+		sim->time = sim->heap[0]->time;
+	}
+}
+
+static long long sim_now(void* ctx) {
+	return ((struct ssdp_sim*)ctx)->time;
+}
+
+/* Public API */
+
+struct ssdp_sim* ssdp_sim_create(const struct ssdp_sim_config* config) {
+	assert(config);
+	struct ssdp_sim* sim = (struct ssdp_sim*)calloc(1, sizeof(struct ssdp_sim));
+	if (sim == NULL)
+		return NULL;
+	sim->config = *config;
+	sim->random = config->seed * 2654435761ULL + 1;
+	sim->transport.send = sim_send;
+	sim->transport.recv = sim_recv;
+	sim->transport.wait = sim_wait;
+	sim->transport.now = sim_now;
+	sim->transport.ctx = sim;
+	for (int i = 0; i < SIM_BUCKETS; ++i)
+		sim->buckets[i] = -1;
+	return sim;
+}
+
+void ssdp_sim_destroy(struct ssdp_sim* sim) {
+	if (sim == NULL)
+		return;
+	for (int i = 0; i < sim->heap_count; ++i)
+		free(sim->heap[i]);
+	for (int i = 0; i < sim->socket_count; ++i) {
+		struct sim_datagram* dg = sim->sockets[i].head;
+		while (dg) {
+			struct sim_datagram* next = dg->next;
+			free(dg);
+			dg = next;
+		}
+	}
+	free(sim->heap);
+	free(sim->members);
+	free(sim->sockets);
+	free(sim);
+}
+
+const struct ssdp_transport* ssdp_sim_transport(struct ssdp_sim* sim) {
+	assert(sim);
+	return &sim->transport;
+}
+
+ssdp_socket_t ssdp_sim_socket(struct ssdp_sim* sim, const struct sockaddr_in* addr, int multicast) {
+	assert(sim && addr);
+	if (find_socket(sim, addr) != -1)
+		return -1;
+	if (grow((void**)&sim->sockets, &sim->socket_capacity, sim->socket_count + 1, sizeof(*sim->sockets)) == -1)
+		return -1;
+	if (multicast && grow((void**)&sim->members, &sim->member_capacity, sim->member_count + 1, sizeof(*sim->members)) == -1)
+		return -1;
+
+	ssdp_socket_t s = sim->socket_count++;
+	struct sim_socket* sock = &sim->sockets[s];
+	memset(sock, 0, sizeof(*sock));
+	sock->addr = *addr;
+	sock->multicast = multicast;
+	unsigned int bucket = addr_hash(addr);
+	sock->next = sim->buckets[bucket];
+	sim->buckets[bucket] = s;
+	if (multicast)
+		sim->members[sim->member_count++] = s;
+	return s;
+}
+
+void ssdp_sim_set_handler(struct ssdp_sim* sim, ssdp_socket_t s, pf_ssdp_sim_handler handler, void* param) {
+	assert(sim && valid_socket(sim, s));
+	sim->sockets[s].handler = handler;
+	sim->sockets[s].param = param;
+}
+
+void ssdp_sim_run(struct ssdp_sim* sim, long long time) {
+	assert(sim);
+	while (sim->heap_count && (time < 0 || sim->heap[0]->time <= time))
+		deliver_next(sim);
+	if (sim->time < time)
+		sim->time = time;
+}
+
+long long ssdp_sim_time(const struct ssdp_sim* sim) {
+	assert(sim);
+	return sim->time;
+}
+
+void ssdp_sim_stats(const struct ssdp_sim* sim, struct ssdp_sim_stats* stats) {
+	assert(sim && stats);
+	*stats = sim->stats;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "../ssdp-connect.h"
+
+/* In-memory simulated network for testing ssdp_scan_ex() and ssdp_listen_ex() at scale.
+ *
+ * Simulator runs on virtual time and is single-threaded and deterministic: the same config and
+ * the same sequence of calls always produce the same result. Time advances only inside transport's
+ * wait(), which delivers scheduled datagrams in order of their arrival time.
+ * Virtual sockets are identified by ssdp_socket_t values returned by ssdp_sim_socket(), they are
+ * valid only for the simulator's transport. Datagrams sent to SSDP_IP:SSDP_PORT are delivered to
+ * every multicast socket, other datagrams are delivered to the socket bound to destination address.
+ * A socket may have a handler, then datagrams are passed to it on arrival instead of being queued,
+ * that is how virtual servers and clients are implemented without threads. */
+
+struct ssdp_sim;
+
+struct ssdp_sim_config {
+	long latency_msec;  /* one-way delivery delay */
+	long jitter_msec;   /* random extra delay in [0, jitter_msec], reorders datagrams */
+	double loss;        /* probability that datagram is lost (for every receiver of a multicast) */
+	int rcvbuf;         /* receive buffer size of queued sockets in bytes, datagrams that don't fit are dropped */
+	unsigned int seed;  /* random seed */
+};
+
+/* Datagram counters */
+struct ssdp_sim_stats {
+	long sent;          /* send() calls */
+	long delivered;     /* datagrams queued to sockets or passed to handlers */
+	long lost;          /* datagrams dropped due to <loss> */
+	long overflowed;    /* datagrams dropped due to <rcvbuf> */
+	long unreachable;   /* datagrams sent to address without a socket */
+};
+
+/* Called when datagram arrives to socket with a handler. May send datagrams through the simulator's transport */
+typedef void(*pf_ssdp_sim_handler)(struct ssdp_sim* sim, ssdp_socket_t s, const char* data, int size,
+	const struct sockaddr_in* from, void* param);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns NULL on error */
+struct ssdp_sim* ssdp_sim_create(const struct ssdp_sim_config* config);
+void ssdp_sim_destroy(struct ssdp_sim* sim);
+
+/* Returns transport working with virtual sockets of <sim> */
+const struct ssdp_transport* ssdp_sim_transport(struct ssdp_sim* sim);
+
+/* Creates virtual socket bound to <addr>. Set <multicast> to 1 to join SSDP multicast group
+ * (like ssdp_socket_init() does), <addr> port should be SSDP_PORT then.
+ * Returns socket id on success, -1 on error (e.g. address is already in use) */
+ssdp_socket_t ssdp_sim_socket(struct ssdp_sim* sim, const struct sockaddr_in* addr, int multicast);
+
+/* Sets handler of socket <s>, pass NULL to queue datagrams again */
+void ssdp_sim_set_handler(struct ssdp_sim* sim, ssdp_socket_t s, pf_ssdp_sim_handler handler, void* param);
+
+/* Delivers all scheduled datagrams which arrive until <time> (or all of them if <time> is -1) */
+void ssdp_sim_run(struct ssdp_sim* sim, long long time);
+
+/* Returns virtual time in milliseconds */
+long long ssdp_sim_time(const struct ssdp_sim* sim);
+
+void ssdp_sim_stats(const struct ssdp_sim* sim, struct ssdp_sim_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
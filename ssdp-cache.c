@@ -0,0 +1,429 @@
+/* ftruncate() and mmap() are POSIX, declare them in strict ISO C modes too */
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "ssdp-cache.h"
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+#define header_size sizeof(struct ssdp_cache_header)
+#define file_size(capacity) (header_size + (size_t)(capacity) * sizeof(struct ssdp_cache_entry))
+
+#ifdef SSDP_PLATFORM_WINDOWS
+
+inline static int cache_file_open(struct ssdp_cache* c, const char* path, size_t* size) {
+	LARGE_INTEGER file_size;
+	c->mapping = NULL;
+	c->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (c->file == INVALID_HANDLE_VALUE)
+		return -1;
+	if (!GetFileSizeEx(c->file, &file_size)) {
+		CloseHandle(c->file);
+		return -1;
+	}
+	*size = (size_t)file_size.QuadPart;
+	return 0;
+}
+
+inline static int cache_file_resize(struct ssdp_cache* c, size_t size) {
+	LARGE_INTEGER pos;
+	pos.QuadPart = 0;
+	if (!SetFilePointerEx(c->file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(c->file))
+		return -1;
+	pos.QuadPart = (LONGLONG)size;
+	if (!SetFilePointerEx(c->file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(c->file))
+		return -1;
+	return 0;
+}
+
+inline static int cache_file_map(struct ssdp_cache* c, size_t size) {
+	c->mapping = CreateFileMappingA(c->file, NULL, PAGE_READWRITE, 0, 0, NULL);
+	if (c->mapping == NULL)
+		return -1;
+	c->header = (struct ssdp_cache_header*)MapViewOfFile(c->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (c->header == NULL) {
+		CloseHandle(c->mapping);
+		c->mapping = NULL;
+		return -1;
+	}
+	c->size = size;
+	return 0;
+}
+
+inline static void cache_file_unmap(struct ssdp_cache* c) {
+	if (c->header) {
+		FlushViewOfFile(c->header, 0);
+		UnmapViewOfFile(c->header);
+		c->header = NULL;
+	}
+	if (c->mapping) {
+		CloseHandle(c->mapping);
+		c->mapping = NULL;
+	}
+}
+
+inline static void cache_file_close(struct ssdp_cache* c) {
+	FlushFileBuffers(c->file);
+	CloseHandle(c->file);
+	c->file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+inline static int cache_file_open(struct ssdp_cache* c, const char* path, size_t* size) {
+	struct stat st;
+	c->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (c->fd == -1)
+		return -1;
+	if (fstat(c->fd, &st) == -1) {
+		close(c->fd);
+		return -1;
+	}
+	*size = (size_t)st.st_size;
+	return 0;
+}
+
+inline static int cache_file_resize(struct ssdp_cache* c, size_t size) {
+	/* truncate to zero first so the stale contents are not kept */
+	if (ftruncate(c->fd, 0) == -1 || ftruncate(c->fd, (off_t)size) == -1)
+		return -1;
+	return 0;
+}
+
+inline static int cache_file_map(struct ssdp_cache* c, size_t size) {
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+	if (p == MAP_FAILED)
+		return -1;
+	c->header = (struct ssdp_cache_header*)p;
+	c->size = size;
+	return 0;
+}
+
+inline static void cache_file_unmap(struct ssdp_cache* c) {
+	if (c->header) {
+		msync(c->header, c->size, MS_SYNC);
+		munmap(c->header, c->size);
+		c->header = NULL;
+	}
+}
+
+inline static void cache_file_close(struct ssdp_cache* c) {
+	close(c->fd);
+	c->fd = -1;
+}
+
+#endif
+
+/* Check that mapped file is a cache of the current version and layout */
+static int cache_valid(const struct ssdp_cache* c) {
+	const struct ssdp_cache_header* h = c->header;
+	return memcmp(h->magic, SSDP_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+		h->version == SSDP_CACHE_VERSION &&
+		h->entry_size == sizeof(struct ssdp_cache_entry) &&
+		h->capacity > 0 && h->count <= h->capacity &&
+		file_size(h->capacity) == c->size;
+}
+
+/* Copy string to cache entry field, truncating if it is too long */
+static void copy_field(char* field, const char* value) {
+	size_t len = value ? strlen(value) : 0;
+	if (len >= SSDP_CACHE_FIELD_SIZE)
+		len = SSDP_CACHE_FIELD_SIZE - 1;
+	if (len)
+		memcpy(field, value, len);
+	memset(field + len, 0, SSDP_CACHE_FIELD_SIZE - len);
+}
+
+inline static int entry_valid(const struct ssdp_cache_entry* e, int64_t now) {
+	return e->last_seen + e->max_age > now;
+}
+
+int ssdp_cache_open(struct ssdp_cache* cache, const char* path, int capacity) {
+	assert(cache && path && capacity > 0);
+	cache->header = NULL;
+	cache->entries = NULL;
+	cache->size = 0;
+
+	size_t size;
+	if (cache_file_open(cache, path, &size) == -1)
+		return -1;
+
+	/* reuse existing file as is */
+	if (size >= header_size && cache_file_map(cache, size) == 0) {
+		if (cache_valid(cache))
+			goto Done;
+		cache_file_unmap(cache);
+	}
+
+	/* create new file */
+	size = file_size(capacity);
+	if (cache_file_resize(cache, size) == -1 || cache_file_map(cache, size) == -1) {
+		cache_file_close(cache);
+		return -1;
+	}
+	memcpy(cache->header->magic, SSDP_CACHE_MAGIC, sizeof(cache->header->magic));
+	cache->header->version = SSDP_CACHE_VERSION;
+	cache->header->entry_size = sizeof(struct ssdp_cache_entry);
+	cache->header->capacity = (uint32_t)capacity;
+	cache->header->count = 0;
+
+Done:
+	cache->entries = (struct ssdp_cache_entry*)(cache->header + 1);
+	/* file may be damaged, make sure strings are terminated */
+	for (uint32_t i = 0; i < cache->header->count; ++i) {
+		cache->entries[i].service_type[SSDP_CACHE_FIELD_SIZE - 1] = '\0';
+		cache->entries[i].service_name[SSDP_CACHE_FIELD_SIZE - 1] = '\0';
+		cache->entries[i].user_agent[SSDP_CACHE_FIELD_SIZE - 1] = '\0';
+	}
+	return 0;
+}
+
+void ssdp_cache_close(struct ssdp_cache* cache) {
+	assert(cache);
+	if (cache->header == NULL)
+		return;
+	cache_file_unmap(cache);
+	cache_file_close(cache);
+	cache->entries = NULL;
+	cache->size = 0;
+}
+
+int ssdp_cache_update(struct ssdp_cache* cache, const char* service_type, const char* service_name,
+	const char* user_agent, const struct sockaddr_in* server, int max_age) {
+	assert(cache && service_type && service_name && server);
+	if (cache->header == NULL || service_name[0] == '\0')
+		return -1;
+
+	struct ssdp_cache_header* h = cache->header;
+	struct ssdp_cache_entry* e = NULL;
+	int64_t now = (int64_t)time(NULL);
+	int result = 1;
+
+	/* find entry by service name, otherwise take a free or the oldest slot */
+	for (uint32_t i = 0; i < h->count; ++i) {
+		if (strncmp(cache->entries[i].service_name, service_name, SSDP_CACHE_FIELD_SIZE - 1) == 0) {
+			e = &cache->entries[i];
+			break;
+		}
+	}
+	if (e) {
+		if (entry_valid(e, now) && e->addr == server->sin_addr.s_addr && e->port == server->sin_port)
+			result = 0;
+	}
+	else if (h->count < h->capacity)
+		e = &cache->entries[h->count++];
+	else {
+		e = &cache->entries[0];
+		for (uint32_t i = 1; i < h->count; ++i)
+			if (cache->entries[i].last_seen + cache->entries[i].max_age < e->last_seen + e->max_age)
+				e = &cache->entries[i];
+	}
+
+	e->last_seen = now;
+	e->max_age = max_age;
+	e->addr = server->sin_addr.s_addr;
+	e->port = server->sin_port;
+	e->flags = 0;
+	memset(e->reserved, 0, sizeof(e->reserved));
+	copy_field(e->service_type, service_type);
+	copy_field(e->service_name, service_name);
+	copy_field(e->user_agent, user_agent);
+	return result;
+}
+
+/* Remove entry at <i>, keeping used slots contiguous */
+static void remove_at(struct ssdp_cache* cache, uint32_t i) {
+	struct ssdp_cache_header* h = cache->header;
+	if (i != --h->count)
+		cache->entries[i] = cache->entries[h->count];
+	memset(&cache->entries[h->count], 0, sizeof(struct ssdp_cache_entry));
+}
+
+int ssdp_cache_remove(struct ssdp_cache* cache, const char* service_name) {
+	assert(cache && service_name);
+	if (cache->header == NULL)
+		return 0;
+
+	for (uint32_t i = 0; i < cache->header->count; ++i) {
+		if (strncmp(cache->entries[i].service_name, service_name, SSDP_CACHE_FIELD_SIZE - 1) == 0) {
+			remove_at(cache, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int ssdp_cache_scan(const struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long stale_sec, pf_ssdp_cache_callback callback, void* callback_param) {
+	assert(cache && service_type && callback);
+	if (cache->header == NULL)
+		return 0;
+
+	int result = 0;
+	int64_t now = (int64_t)time(NULL);
+	char service_name[SSDP_CACHE_FIELD_SIZE], user_agent[SSDP_CACHE_FIELD_SIZE];
+	struct sockaddr_in server;
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+
+	/* fresh entries first, then stale ones */
+	for (int pass = 0; pass < 2 && result == 0; ++pass) {
+		SSDP_CACHE_STATUS status = pass == 0 ? SSDP_CACHE_FRESH : SSDP_CACHE_STALE;
+		uint32_t i = 0;
+		while (i < cache->header->count) {
+			const struct ssdp_cache_entry* e = &cache->entries[i];
+			if (strncmp(e->service_type, service_type, service_type_len) != 0 ||
+				entry_valid(e, now) != (status == SSDP_CACHE_FRESH) ||
+				(status == SSDP_CACHE_STALE && stale_sec >= 0 && e->last_seen + stale_sec <= now)) {
+				++i;
+				continue;
+			}
+			/* callback may remove the entry, which overwrites its slot */
+			memcpy(service_name, e->service_name, sizeof(service_name));
+			memcpy(user_agent, e->user_agent, sizeof(user_agent));
+			server.sin_addr.s_addr = e->addr;
+			server.sin_port = e->port;
+			uint32_t count = cache->header->count;
+			result = callback(service_name, user_agent, &server, status, callback_param);
+			if (result)
+				break;
+			/* removed entry is replaced by the last one, which is not visited yet */
+			if (cache->header->count >= count)
+				++i;
+		}
+	}
+
+	return result;
+}
+
+/* ssdp_cache_revalidate() state passed to revalidate_callback() */
+struct revalidate_param {
+	struct ssdp_cache* cache;
+	const char* service_type;
+	pf_ssdp_cache_callback callback;
+	void* callback_param;
+	int stopped;
+	const struct ssdp_transport* transport;
+	int sent;  /* number of successfully sent ssdp:discover requests */
+};
+
+/* Transport passing calls through to revalidate_param::transport, counting successful sends */
+
+static int revalidate_send(void* ctx, ssdp_socket_t s, const char* data, int size, const struct sockaddr_in* to) {
+	struct revalidate_param* p = (struct revalidate_param*)ctx;
+	int result = p->transport->send(p->transport->ctx, s, data, size, to);
+	if (result >= 0)
+		++p->sent;
+	return result;
+}
+
+static int revalidate_recv(void* ctx, ssdp_socket_t s, char* buffer, int size, struct sockaddr_in* from) {
+	struct revalidate_param* p = (struct revalidate_param*)ctx;
+	return p->transport->recv(p->transport->ctx, s, buffer, size, from);
+}
+
+static int revalidate_wait(void* ctx, const ssdp_socket_t* sockets, int* readable, int count, long timeout_msec) {
+	struct revalidate_param* p = (struct revalidate_param*)ctx;
+	return p->transport->wait(p->transport->ctx, sockets, readable, count, timeout_msec);
+}
+
+static long long revalidate_now(void* ctx) {
+	struct revalidate_param* p = (struct revalidate_param*)ctx;
+	return p->transport->now(p->transport->ctx);
+}
+
+/* Refresh cache and forward servers that were not fresh in it (or all servers, if cache is not open) */
+static int revalidate_callback(const char* service_name, const char* user_agent, const struct sockaddr_in* server, void* param) {
+	struct revalidate_param* p = (struct revalidate_param*)param;
+	if (p->cache->header && ssdp_cache_update(p->cache, p->service_type, service_name, user_agent, server, SSDP_CACHE_MAX_AGE) <= 0)
+		return 0;
+	int result = p->callback(service_name, user_agent, server, SSDP_CACHE_FOUND, p->callback_param);
+	if (result)
+		p->stopped = 1;
+	return result;
+}
+
+int ssdp_cache_revalidate(ssdp_socket_t client, struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long discover_period_msec, int retries, pf_ssdp_cache_callback callback, void* callback_param) {
+	return ssdp_cache_revalidate_ex(ssdp_default_transport(), client, cache, service_type, service_type_len,
+		discover_period_msec, retries, callback, callback_param);
+}
+
+int ssdp_cache_revalidate_ex(const struct ssdp_transport* transport, ssdp_socket_t client, struct ssdp_cache* cache,
+	const char* service_type, size_t service_type_len, long discover_period_msec, int retries,
+	pf_ssdp_cache_callback callback, void* callback_param) {
+	assert(transport && cache && callback);
+
+	/* responses clear the flag (see ssdp_cache_update()) */
+	for (uint32_t i = 0; cache->header && i < cache->header->count; ++i)
+		if (strncmp(cache->entries[i].service_type, service_type, service_type_len) == 0)
+			cache->entries[i].flags |= SSDP_CACHE_PENDING;
+
+	struct revalidate_param p = { cache, service_type, callback, callback_param, 0, transport, 0 };
+	struct ssdp_transport counting = { revalidate_send, revalidate_recv, revalidate_wait, revalidate_now, &p };
+	int result = ssdp_scan_ex(&counting, client, service_type, service_type_len, discover_period_msec, retries, revalidate_callback, &p);
+	/* scan was interrupted, we don't know who is gone */
+	if (result < 0 || p.stopped)
+		return result;
+	/* nothing was sent (e.g. network is down yet), absence of responses means nothing */
+	if (p.sent == 0)
+		return -1;
+	/* cache is not open (ssdp_cache_open() failed), it was a plain scan */
+	if (cache->header == NULL)
+		return 0;
+
+	/* remove expired servers that didn't respond, keep the rest until their max-age passes */
+	int64_t now = (int64_t)time(NULL);
+	char service_name[SSDP_CACHE_FIELD_SIZE], user_agent[SSDP_CACHE_FIELD_SIZE];
+	struct sockaddr_in server;
+	memset(&server, 0, sizeof(server));
+	server.sin_family = AF_INET;
+
+	uint32_t i = 0;
+	while (i < cache->header->count) {
+		const struct ssdp_cache_entry* e = &cache->entries[i];
+		if (!(e->flags & SSDP_CACHE_PENDING) || strncmp(e->service_type, service_type, service_type_len) != 0) {
+			++i;
+			continue;
+		}
+		if (entry_valid(e, now)) {
+			cache->entries[i++].flags &= ~SSDP_CACHE_PENDING;
+			continue;
+		}
+		memcpy(service_name, e->service_name, sizeof(service_name));
+		memcpy(user_agent, e->user_agent, sizeof(user_agent));
+		server.sin_addr.s_addr = e->addr;
+		server.sin_port = e->port;
+		remove_at(cache, i);
+		callback(service_name, user_agent, &server, SSDP_CACHE_GONE, callback_param);
+	}
+
+	return 0;
+}
+
+int ssdp_scan_cached(ssdp_socket_t client, struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long stale_sec, long discover_period_msec, int retries, pf_ssdp_cache_callback callback, void* callback_param) {
+	return ssdp_scan_cached_ex(ssdp_default_transport(), client, cache, service_type, service_type_len,
+		stale_sec, discover_period_msec, retries, callback, callback_param);
+}
+
+int ssdp_scan_cached_ex(const struct ssdp_transport* transport, ssdp_socket_t client, struct ssdp_cache* cache,
+	const char* service_type, size_t service_type_len, long stale_sec, long discover_period_msec, int retries,
+	pf_ssdp_cache_callback callback, void* callback_param) {
+	assert(transport && cache && callback);
+
+	/* report cached servers right away */
+	int result = ssdp_cache_scan(cache, service_type, service_type_len, stale_sec, callback, callback_param);
+	if (result)
+		return result;
+
+	return ssdp_cache_revalidate_ex(transport, client, cache, service_type, service_type_len,
+		discover_period_msec, retries, callback, callback_param);
+}
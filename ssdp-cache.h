@@ -0,0 +1,127 @@
+#pragma once
+#include <stdint.h>
+#include "ssdp-connect.h"
+
+/* Persistent cache of discovered servers.
+ *
+ * The cache is a fixed-layout file which is memory-mapped as is, so loading it requires no parsing.
+ * Layout: struct ssdp_cache_header followed by <capacity> slots of struct ssdp_cache_entry,
+ * the first <count> slots are in use. Entries are keyed by service name (USN).
+ * Integers are stored in host byte order (address and port in network byte order, like in sockaddr_in),
+ * so the file is not meant to be moved between machines. File with unknown magic, version or layout
+ * is silently reinitialized.
+ * Cache is not thread-safe and must not be opened by several processes simultaneously. */
+
+#define SSDP_CACHE_MAGIC "SSDPCACH"
+#define SSDP_CACHE_VERSION 1
+
+/* size of each string field (including zero-terminator) */
+#define SSDP_CACHE_FIELD_SIZE 128
+
+/* max-age (in seconds) of entries refreshed by ssdp_cache_revalidate(), same as ssdp_response() advertises.
+ * Entries past their max-age are not dropped, they are still offered as stale candidates (see ssdp_cache_scan()) */
+#define SSDP_CACHE_MAX_AGE 120
+
+/* entry flag: waiting for response to ssdp_cache_revalidate() */
+#define SSDP_CACHE_PENDING 1
+
+/* Status of a server reported by ssdp_cache_scan(), ssdp_cache_revalidate() and ssdp_scan_cached() */
+typedef enum {
+	SSDP_CACHE_FRESH = 0,  /* cached, within its max-age */
+	SSDP_CACHE_STALE,      /* cached, past its max-age: unconfirmed candidate */
+	SSDP_CACHE_FOUND,      /* responded to revalidation and was not fresh in cache: new, moved or stale */
+	SSDP_CACHE_GONE        /* past its max-age, didn't respond to revalidation and was removed from cache */
+} SSDP_CACHE_STATUS;
+
+struct ssdp_cache_header {
+	char magic[8];        /* SSDP_CACHE_MAGIC without zero-terminator */
+	uint32_t version;     /* SSDP_CACHE_VERSION */
+	uint32_t entry_size;  /* sizeof(struct ssdp_cache_entry) */
+	uint32_t capacity;    /* number of entry slots in file */
+	uint32_t count;       /* number of used entry slots */
+};
+
+struct ssdp_cache_entry {
+	int64_t last_seen;    /* unix time (seconds) of the last response */
+	int32_t max_age;      /* entry is valid until last_seen + max_age */
+	uint32_t addr;        /* server IPv4 address, network byte order */
+	uint16_t port;        /* server port, network byte order */
+	uint16_t flags;       /* SSDP_CACHE_PENDING */
+	uint16_t reserved[2];
+	char service_type[SSDP_CACHE_FIELD_SIZE];
+	char service_name[SSDP_CACHE_FIELD_SIZE];
+	char user_agent[SSDP_CACHE_FIELD_SIZE];
+};
+
+struct ssdp_cache {
+	struct ssdp_cache_header* header;
+	struct ssdp_cache_entry* entries;
+	size_t size;
+#ifdef SSDP_PLATFORM_WINDOWS
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+/* return <0 on error, return 0 to continue, return >0 to stop (return value is ignored for SSDP_CACHE_GONE) */
+typedef int(*pf_ssdp_cache_callback)(const char* service_name, const char* user_agent, const struct sockaddr_in* server,
+	SSDP_CACHE_STATUS status, void* param);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Opens (or creates) cache file at <path> and maps it to memory.
+ * <capacity> - number of entries in a newly created file, existing valid file keeps its capacity
+ * Returns 0 on success, -1 on error */
+int ssdp_cache_open(struct ssdp_cache* cache, const char* path, int capacity);
+
+/* Flushes cache to disk and unmaps it */
+void ssdp_cache_close(struct ssdp_cache* cache);
+
+/* Adds or refreshes entry of <service_name>. If cache is full, the oldest entry is replaced.
+ * <max_age> - number of seconds the entry stays valid
+ * Returns 1 if the entry is new, was expired or changed its address, 0 if it was just refreshed, -1 on error */
+int ssdp_cache_update(struct ssdp_cache* cache, const char* service_type, const char* service_name,
+	const char* user_agent, const struct sockaddr_in* server, int max_age);
+
+/* Removes entry of <service_name> (e.g. on ssdp:byebye or failed connection, also from ssdp_cache_scan() callback).
+ * Returns 1 if entry was removed, 0 if not found */
+int ssdp_cache_remove(struct ssdp_cache* cache, const char* service_name);
+
+/* Calls <callback> for cached entries of <service_type>: first for fresh ones, then for stale ones.
+ * <stale_sec> - stale entries not seen for this number of seconds are skipped, -1 to report all of them
+ * <callback> may remove the reported entry with ssdp_cache_remove() (e.g. when connection to it failed),
+ * but must not change the cache otherwise.
+ * Returns the last return value of <callback> */
+int ssdp_cache_scan(const struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long stale_sec, pf_ssdp_cache_callback callback, void* callback_param);
+
+/* Runs ssdp_scan() (ssdp_scan_ex() with <transport>) and refreshes cache with responses, <callback> is called with SSDP_CACHE_FOUND
+ * for servers that were not fresh in cache. If scan was not stopped by <callback>, cached entries of <service_type>
+ * that didn't respond and are past their max-age are removed and reported with SSDP_CACHE_GONE,
+ * entries within their max-age are kept.
+ * Returns <0 on error (including failure to send any ssdp:discover, then nothing is removed),
+ * >0 if stopped by <callback>, 0 otherwise.
+ * If cache is not open (ssdp_cache_open() failed), works as ssdp_scan() reporting every response with SSDP_CACHE_FOUND */
+int ssdp_cache_revalidate(ssdp_socket_t client, struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long discover_period_msec, int retries, pf_ssdp_cache_callback callback, void* callback_param);
+int ssdp_cache_revalidate_ex(const struct ssdp_transport* transport, ssdp_socket_t client, struct ssdp_cache* cache,
+	const char* service_type, size_t service_type_len, long discover_period_msec, int retries,
+	pf_ssdp_cache_callback callback, void* callback_param);
+
+/* ssdp_cache_scan() followed by ssdp_cache_revalidate(), so cached servers are reported right away.
+ * If <callback> stops on a cached server (e.g. to connect to it), revalidation is skipped:
+ * call ssdp_cache_revalidate() later, after the connection is made.
+ * If cache is not open, it is a plain scan, so the cache may be treated as optional */
+int ssdp_scan_cached(ssdp_socket_t client, struct ssdp_cache* cache, const char* service_type, size_t service_type_len,
+	long stale_sec, long discover_period_msec, int retries, pf_ssdp_cache_callback callback, void* callback_param);
+int ssdp_scan_cached_ex(const struct ssdp_transport* transport, ssdp_socket_t client, struct ssdp_cache* cache,
+	const char* service_type, size_t service_type_len, long stale_sec, long discover_period_msec, int retries,
+	pf_ssdp_cache_callback callback, void* callback_param);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,4 +1,5 @@
 #include "ssdp-connect.h"
+#include <assert.h>
 #include <string.h>
 
 #ifdef SSDP_PLATFORM_WINDOWS
@@ -7,58 +8,84 @@
 #include <sys/poll.h>
 #endif
 
-#ifdef SSDP_PLATFORM_WINDOWS
-
-#include <profileapi.h>
+/* Default transport */
 
-struct looper {
-	LARGE_INTEGER prevtime;
-	LARGE_INTEGER curtime;
-	LARGE_INTEGER time;
-	LARGE_INTEGER period;
-};
+static int default_send(void* ctx, ssdp_socket_t s, const char* data, int size, const struct sockaddr_in* to) {
+	return sendto(s, data, size, 0, (const struct sockaddr*)to, sizeof(*to));
+}
 
-inline static void looper_start(struct looper* l, long period) {
-	LARGE_INTEGER perf_freq;
-	QueryPerformanceFrequency(&perf_freq);
-	QueryPerformanceCounter(&l->prevtime);
-	l->curtime = l->prevtime;
-	l->time.QuadPart = period * perf_freq.QuadPart / 1000;
-	l->period = l->time;
+static int default_recv(void* ctx, ssdp_socket_t s, char* buffer, int size, struct sockaddr_in* from) {
+	socklen_t fromsize = sizeof(*from);
+	return recvfrom(s, buffer, size, 0, (struct sockaddr*)from, &fromsize);
 }
 
-inline static int looper_check(struct looper* l) {
-	QueryPerformanceCounter(&l->curtime);
-	l->time.QuadPart += l->curtime.QuadPart - l->prevtime.QuadPart;
-	l->prevtime = l->curtime;
-	return l->time.QuadPart >= l->period.QuadPart;
+static int default_wait(void* ctx, const ssdp_socket_t* sockets, int* readable, int count, long timeout_msec) {
+	struct pollfd pfd[2];
+	assert(count > 0 && count <= 2);
+	for (int i = 0; i < count; ++i) {
+		pfd[i].fd = sockets[i];
+		pfd[i].events = POLLIN;
+		pfd[i].revents = 0;
+	}
+	int result = poll(pfd, count, timeout_msec);
+	for (int i = 0; i < count; ++i)
+		readable[i] = result > 0 && (pfd[i].revents & POLLIN);
+	return result;
 }
 
-inline static void looper_reset(struct looper* l) {
-	l->time.QuadPart = 0;
+#ifdef SSDP_PLATFORM_WINDOWS
+
+#include <profileapi.h>
+
+static long long default_now(void* ctx) {
+	LARGE_INTEGER perf_freq, counter;
+	QueryPerformanceFrequency(&perf_freq);
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / perf_freq.QuadPart * 1000 + counter.QuadPart % perf_freq.QuadPart * 1000 / perf_freq.QuadPart;
 }
 
 #else
 
 #include <time.h>
 
+static long long default_now(void* ctx) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long long)t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+#endif
+
+static const struct ssdp_transport default_transport = {
+	default_send,
+	default_recv,
+	default_wait,
+	default_now,
+	NULL
+};
+
+const struct ssdp_transport* ssdp_default_transport() {
+	return &default_transport;
+}
+
+/* Periodic timer on transport's clock */
 struct looper {
-	struct timespec prevtime;
-	struct timespec curtime;
-	long time;
-	long period;
+	const struct ssdp_transport* transport;
+	long long prevtime;
+	long long time;
+	long long period;
 };
 
-inline static void looper_start(struct looper* l, long period) {
-	clock_gettime(CLOCK_MONOTONIC, &l->prevtime);
-	l->curtime = l->prevtime;
+inline static void looper_start(struct looper* l, const struct ssdp_transport* transport, long period) {
+	l->transport = transport;
+	l->prevtime = transport->now(transport->ctx);
 	l->period = l->time = period;
 }
 
 inline static int looper_check(struct looper* l) {
-	clock_gettime(CLOCK_MONOTONIC, &l->curtime);
-	l->time += ((l->curtime.tv_sec * 1000) + (l->curtime.tv_nsec / 1000000)) - ((l->prevtime.tv_sec * 1000) + (l->prevtime.tv_nsec / 1000000));
-	l->prevtime = l->curtime;
+	long long curtime = l->transport->now(l->transport->ctx);
+	l->time += curtime - l->prevtime;
+	l->prevtime = curtime;
 	return l->time >= l->period;
 }
 
@@ -66,48 +93,59 @@ inline static void looper_reset(struct looper* l) {
 	l->time = 0;
 }
 
-#endif
-
 int ssdp_listen(ssdp_socket_t ssdp_sock, ssdp_socket_t server, const char* service_type, size_t service_type_len,
 	const char* service_name, const char* user_agent, pf_ssdp_listen_callback callback, void* callback_param) {
+	return ssdp_listen_ex(&default_transport, ssdp_sock, server, service_type, service_type_len,
+		service_name, user_agent, callback, callback_param);
+}
+
+int ssdp_listen_handle(const struct ssdp_transport* transport, ssdp_socket_t server, const char* service_type,
+	size_t service_type_len, const char* service_name, const char* user_agent,
+	const char* data, int size, const struct sockaddr_in* from) {
+	/* request information */
+	SSDP_REQUEST_TYPE req_type = SSDP_RT_NONE;
+	char req_svc_type[128];
+	req_svc_type[0] = '\0';
+
+	if (ssdp_parse_request(data, size, &req_type, req_svc_type, sizeof(req_svc_type), NULL, 0, NULL, 0) > 0 &&
+		req_type == SSDP_RT_DISCOVER && strncmp(req_svc_type, service_type, service_type_len) == 0) {
+		char buffer[512];
+		int result = ssdp_response(service_type, service_name, user_agent, buffer, sizeof(buffer));
+		result = transport->send(transport->ctx, server, buffer, result, from);
+		return result < 0 ? result : 1;
+	}
+	return 0;
+}
+
+int ssdp_listen_ex(const struct ssdp_transport* transport, ssdp_socket_t ssdp_sock, ssdp_socket_t server,
+	const char* service_type, size_t service_type_len, const char* service_name, const char* user_agent,
+	pf_ssdp_listen_callback callback, void* callback_param) {
 	/* for socket I/O */
 	int result = 0;
 	char buffer[512] = { 0 };
 	struct sockaddr_in from;
-	int fromsize = sizeof(from);
-
-	/* request information */
-	SSDP_REQUEST_TYPE req_type;
-	char req_svc_type[128];
 
-	/* pollfd for poll() */
-	struct pollfd pfd[2];
-	pfd[0].fd = ssdp_sock;
-	pfd[1].fd = server;
-	pfd[1].events = pfd[0].events = POLLIN;
+	/* sockets to wait on */
+	const ssdp_socket_t sockets[2] = { ssdp_sock, server };
+	int readable[2];
 
 	while (result >= 0) {
 		/* wait on SSDP and server socket */
-		result = poll(pfd, 2, -1);
+		result = transport->wait(transport->ctx, sockets, readable, 2, -1);
 		if (result <= 0)
 			continue;
 		/* receive requests and respond */
-		if (pfd[0].revents & POLLIN) {
-			pfd[0].revents = 0;
-			result = recvfrom(ssdp_sock, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromsize);
+		if (readable[0]) {
+			result = transport->recv(transport->ctx, ssdp_sock, buffer, sizeof(buffer), &from);
 			if (result < 0)
 				break;
-			if (ssdp_parse_request(buffer, result, &req_type, req_svc_type, sizeof(req_svc_type), NULL, 0, NULL, 0) > 0 &&
-				req_type == SSDP_RT_DISCOVER && strncmp(req_svc_type, service_type, service_type_len) == 0) {
-				result = ssdp_response(service_type, service_name, user_agent, buffer, sizeof(buffer));
-				sendto(server, buffer, result, 0, (struct sockaddr*)&from, sizeof(from));
-			}
+			ssdp_listen_handle(transport, server, service_type, service_type_len,
+				service_name, user_agent, buffer, result, &from);
 			memset(buffer, 0, sizeof(buffer));
 		}
 		/* receive data on server socket and forward it to the callback */
-		if (pfd[1].revents & POLLIN) {
-			pfd[1].revents = 0;
-			result = recvfrom(server, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromsize);
+		if (readable[1]) {
+			result = transport->recv(transport->ctx, server, buffer, sizeof(buffer), &from);
 			if (result <= 0)
 				continue;
 			result = callback(buffer, result, &from, callback_param);
@@ -121,6 +159,12 @@ int ssdp_listen(ssdp_socket_t ssdp_sock, ssdp_socket_t server, const char* servi
 }
 
 int ssdp_scan(ssdp_socket_t client, const char* service_type, size_t service_type_len,
+	long discover_period_msec, int retries, pf_ssdp_scan_callback callback, void* callback_param) {
+	return ssdp_scan_ex(&default_transport, client, service_type, service_type_len,
+		discover_period_msec, retries, callback, callback_param);
+}
+
+int ssdp_scan_ex(const struct ssdp_transport* transport, ssdp_socket_t client, const char* service_type, size_t service_type_len,
 	long discover_period_msec, int retries, pf_ssdp_scan_callback callback, void* callback_param) {
 	/* SSDP multicast address */
 	struct sockaddr_in ssdp_addr;
@@ -130,7 +174,7 @@ int ssdp_scan(ssdp_socket_t client, const char* service_type, size_t service_typ
 	int result = 0;
 	char buffer[512];
 	struct sockaddr_in from;
-	int fromsize = sizeof(from);
+	int readable;
 
 	/* request information */
 	SSDP_REQUEST_TYPE req_type;
@@ -138,13 +182,7 @@ int ssdp_scan(ssdp_socket_t client, const char* service_type, size_t service_typ
 
 	/* for periodic sending */
 	struct looper l;
-	looper_start(&l, discover_period_msec);
-
-	/* pollfd for poll() */
-	struct pollfd pfd = {
-		.fd = client,
-		.events = POLLIN
-	};
+	looper_start(&l, transport, discover_period_msec);
 
 	while (result >= 0) {
 		/* send ssdp:discover every N msec */
@@ -153,16 +191,18 @@ int ssdp_scan(ssdp_socket_t client, const char* service_type, size_t service_typ
 				break;
 			looper_reset(&l);
 			result = ssdp_discover(service_type, buffer, sizeof(buffer));
-			sendto(client, buffer, result, 0, (struct sockaddr*)&ssdp_addr, sizeof(ssdp_addr));
+			transport->send(transport->ctx, client, buffer, result, &ssdp_addr);
 			memset(buffer, 0, sizeof(buffer));
 		}
 		/* receive response */
-		result = poll(&pfd, 1, discover_period_msec);
-		if (pfd.revents & POLLIN) {
-			pfd.revents = 0;
-			result = recvfrom(client, buffer, sizeof(buffer), 0, (struct sockaddr*)&from, &fromsize);
+		result = transport->wait(transport->ctx, &client, &readable, 1, discover_period_msec);
+		if (result > 0 && readable) {
+			result = transport->recv(transport->ctx, client, buffer, sizeof(buffer), &from);
 			if (result <= 0)
 				continue;
+			/* fields missing in request must not be taken from the previous one */
+			req_type = SSDP_RT_NONE;
+			req_svc_type[0] = req_svc_name[0] = req_user_agent[0] = '\0';
 			ssdp_parse_request(buffer, result, &req_type, req_svc_type, sizeof(req_svc_type),
 				req_svc_name, sizeof(req_svc_name), req_user_agent, sizeof(req_user_agent));
 			if (req_type == SSDP_RT_RESPONSE && strncmp(req_svc_type, service_type, service_type_len) == 0) {
@@ -6,12 +6,41 @@
 extern "C" {
 #endif
 
+/* Socket I/O used by the library. ssdp_listen() and ssdp_scan() use ssdp_default_transport() which works
+ * with real sockets, *_ex() variants accept any transport (e.g. simulated network, see sim/ssdp-sim.h). */
+struct ssdp_transport {
+	/* same as sendto(), returns number of bytes sent or <0 on error */
+	int(*send)(void* ctx, ssdp_socket_t s, const char* data, int size, const struct sockaddr_in* to);
+	/* same as recvfrom(), returns number of bytes received or <0 on error */
+	int(*recv)(void* ctx, ssdp_socket_t s, char* buffer, int size, struct sockaddr_in* from);
+	/* waits until any of <count> (at most 2) sockets is readable or <timeout_msec> elapses (-1 to wait forever),
+	 * sets readable[i] to 1 if sockets[i] is readable, otherwise to 0.
+	 * Returns number of readable sockets, 0 on timeout, <0 on error */
+	int(*wait)(void* ctx, const ssdp_socket_t* sockets, int* readable, int count, long timeout_msec);
+	/* returns monotonic time in milliseconds */
+	long long(*now)(void* ctx);
+	void* ctx;
+};
+
+/* Returns transport working with real sockets: sendto(), recvfrom() and poll() */
+const struct ssdp_transport* ssdp_default_transport();
+
 /* return <0 on error, return 0 to continue listening, return >0 to stop listening */
 typedef int(*pf_ssdp_listen_callback)(const char* data, int size, const struct sockaddr_in* client, void* param);
 
 /* server socket must be non-blocking */
 int ssdp_listen(ssdp_socket_t ssdp_sock, ssdp_socket_t server, const char* service_type, size_t service_type_len,
 	const char* service_name, const char* user_agent, pf_ssdp_listen_callback callback, void* callback_param);
+int ssdp_listen_ex(const struct ssdp_transport* transport, ssdp_socket_t ssdp_sock, ssdp_socket_t server,
+	const char* service_type, size_t service_type_len, const char* service_name, const char* user_agent,
+	pf_ssdp_listen_callback callback, void* callback_param);
+
+/* Handles one datagram received on SSDP socket: if it is ssdp:discover of <service_type>, responds to it through <server>.
+ * ssdp_listen() calls it for every received datagram, use it directly to serve SSDP from your own event loop.
+ * Returns 1 if response was sent, 0 if datagram was ignored, <0 on error */
+int ssdp_listen_handle(const struct ssdp_transport* transport, ssdp_socket_t server, const char* service_type,
+	size_t service_type_len, const char* service_name, const char* user_agent,
+	const char* data, int size, const struct sockaddr_in* from);
 
 /* return <0 on error, return 0 to continue scanning, return >0 to manually stop scanning */
 typedef int(*pf_ssdp_scan_callback)(const char* service_name, const char* user_agent, const struct sockaddr_in* server, void* param);
@@ -21,6 +50,8 @@ typedef int(*pf_ssdp_scan_callback)(const char* service_name, const char* user_a
  * client socket must be non-blocking */
 int ssdp_scan(ssdp_socket_t client, const char* service_type, size_t service_type_len,
 	long discover_period_msec, int retries, pf_ssdp_scan_callback callback, void* callback_param);
+int ssdp_scan_ex(const struct ssdp_transport* transport, ssdp_socket_t client, const char* service_type, size_t service_type_len,
+	long discover_period_msec, int retries, pf_ssdp_scan_callback callback, void* callback_param);
 
 #ifdef __cplusplus
 }
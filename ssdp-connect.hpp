@@ -0,0 +1,468 @@
+#pragma once
+#include "ssdp-connect.h"
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(__cpp_impl_coroutine)
+#error ssdp-connect.hpp requires C++20 coroutines
+#endif
+
+#ifdef SSDP_PLATFORM_WINDOWS
+#define SSDP_POLL WSAPoll
+#else
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#define SSDP_POLL poll
+#endif
+
+/* Header-only C++20 layer over ssdp-connect.
+ *
+ * ssdp::socket owns a non-blocking socket. ssdp::reactor is a single-threaded poll() loop which resumes
+ * coroutines waiting for readable sockets or timeouts, so any number of ssdp::task's share one thread.
+ * ssdp::scan() and ssdp::listen() are async generators: co_await gen.next() returns pointer to the next
+ * result or nullptr when generator is finished. Results are views into generator's buffers,
+ * they are valid until the next call of next().
+ *
+ *	ssdp::task discover(ssdp::reactor& r) {
+ *		ssdp::socket client = ssdp::socket::udp();
+ *		auto servers = ssdp::scan(r, client, "someservice:type", std::chrono::milliseconds(3000), 3);
+ *		while (const ssdp::scan_result* server = co_await servers.next())
+ *			...
+ *	}
+ *
+ *	ssdp::reactor r;
+ *	r.spawn(discover(r));
+ *	r.run();
+ *
+ * Nothing here is thread-safe, use one reactor per thread. */
+
+namespace ssdp {
+
+using clock = std::chrono::steady_clock;
+
+inline std::error_code last_error() noexcept {
+#ifdef SSDP_PLATFORM_WINDOWS
+	return std::error_code(WSAGetLastError(), std::system_category());
+#else
+	return std::error_code(errno, std::system_category());
+#endif
+}
+
+/* Owning non-blocking socket handle */
+class socket {
+public:
+	static constexpr ssdp_socket_t invalid = (ssdp_socket_t)-1;
+
+	socket() noexcept = default;
+	/* takes ownership of <s> */
+	explicit socket(ssdp_socket_t s) noexcept : s_(s) {}
+	socket(socket&& other) noexcept : s_(other.release()) {}
+	socket& operator=(socket&& other) noexcept {
+		reset(other.release());
+		return *this;
+	}
+	socket(const socket&) = delete;
+	socket& operator=(const socket&) = delete;
+	~socket() { reset(); }
+
+	/* UDP socket bound to INADDR_ANY:<port> (0 for any port), throws std::system_error on error */
+	static socket udp(unsigned short port = 0) {
+		socket s(::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+		if (!s)
+			throw std::system_error(last_error(), "socket");
+		sockaddr_in host{};
+		host.sin_family = AF_INET;
+		host.sin_addr.s_addr = htonl(INADDR_ANY);
+		host.sin_port = htons(port);
+		if (bind(s.native(), (sockaddr*)&host, sizeof(host)) == -1)
+			throw std::system_error(last_error(), "bind");
+		s.set_nonblocking();
+		return s;
+	}
+
+	/* SSDP multicast socket (see ssdp_socket_init()), throws std::system_error on error */
+	static socket multicast() {
+		socket s(ssdp_socket_init());
+		if (!s)
+			throw std::system_error(last_error(), "ssdp_socket_init");
+		s.set_nonblocking();
+		return s;
+	}
+
+	ssdp_socket_t native() const noexcept { return s_; }
+	explicit operator bool() const noexcept { return s_ != invalid; }
+
+	/* local port in host byte order */
+	unsigned short port() const {
+		sockaddr_in host{};
+		socklen_t size = sizeof(host);
+		if (getsockname(s_, (sockaddr*)&host, &size) == -1)
+			throw std::system_error(last_error(), "getsockname");
+		return ntohs(host.sin_port);
+	}
+
+	ssdp_socket_t release() noexcept { return std::exchange(s_, invalid); }
+
+	void reset(ssdp_socket_t s = invalid) noexcept {
+		if (s_ != invalid)
+			ssdp_socket_release(s_);
+		s_ = s;
+	}
+
+private:
+	void set_nonblocking() {
+#ifdef SSDP_PLATFORM_WINDOWS
+		u_long nonblock = 1;
+		if (ioctlsocket(s_, FIONBIO, &nonblock) != 0)
+#else
+		int nonblock = 1;
+		if (ioctl(s_, FIONBIO, &nonblock) == -1)
+#endif
+			throw std::system_error(last_error(), "FIONBIO");
+	}
+
+	ssdp_socket_t s_ = invalid;
+};
+
+class reactor;
+
+/* Detached coroutine started by reactor::spawn(). Unhandled exception stops reactor::run() and is rethrown from it */
+class task {
+public:
+	struct promise_type {
+		reactor* owner = nullptr;
+		size_t index = 0;  /* position in owner's task list */
+
+		task get_return_object() noexcept { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept;
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept;
+	};
+
+	task(task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+	task& operator=(task&&) = delete;
+	~task() {
+		if (h_)
+			h_.destroy();
+	}
+
+private:
+	friend class reactor;
+	explicit task(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+
+	std::coroutine_handle<promise_type> h_;
+};
+
+/* Single-threaded event loop */
+class reactor {
+	struct waiter {
+		ssdp_socket_t fd[2];
+		int count;
+		clock::time_point deadline;
+		std::coroutine_handle<> h;
+		int* result;
+		bool done;
+	};
+
+	struct wait_awaiter {
+		reactor& r;
+		waiter w;
+		int result = -1;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> h) {
+			w.h = h;
+			w.result = &result;
+			r.waiters_.push_back(w);
+		}
+		int await_resume() const noexcept { return result; }
+	};
+
+	struct readable_awaiter : wait_awaiter {
+		bool await_resume() const noexcept { return this->result == 0; }
+	};
+
+public:
+	reactor() = default;
+	reactor(const reactor&) = delete;
+	reactor& operator=(const reactor&) = delete;
+	~reactor() { destroy_tasks(); }
+
+	/* schedules <t> to start on the next iteration of run() */
+	void spawn(task t) {
+		auto h = std::exchange(t.h_, {});
+		h.promise().owner = this;
+		h.promise().index = tasks_.size();
+		tasks_.push_back(h);
+		ready_.push_back(h);
+	}
+
+	/* runs until all tasks are finished or one of them throws.
+	 * On exception the remaining tasks are destroyed and the exception is rethrown */
+	void run() {
+		struct cleanup {
+			reactor& r;
+			~cleanup() { r.destroy_tasks(); }
+		} guard{ *this };
+
+		std::vector<pollfd> pfd;
+		std::vector<std::coroutine_handle<>> resume;
+		while (!ready_.empty() || !waiters_.empty()) {
+			resume.swap(ready_);
+			for (auto h : resume) {
+				h.resume();
+				if (error_)
+					std::rethrow_exception(std::exchange(error_, nullptr));
+			}
+			resume.clear();
+			if (waiters_.empty() || !ready_.empty())
+				continue;
+
+			/* wait for the first readable socket or the nearest deadline */
+			pfd.clear();
+			clock::time_point deadline = clock::time_point::max();
+			for (const waiter& w : waiters_) {
+				for (int i = 0; i < w.count; ++i)
+					pfd.push_back(pollfd{ w.fd[i], POLLIN, 0 });
+				deadline = std::min(deadline, w.deadline);
+			}
+			int timeout = -1;
+			if (deadline != clock::time_point::max()) {
+				auto msec = std::chrono::ceil<std::chrono::milliseconds>(deadline - clock::now()).count();
+				timeout = (int)std::clamp<decltype(msec)>(msec, 0, 0x7fffffff);
+			}
+			/* WSAPoll() fails without sockets, so only sleep_until() waiters just sleep */
+			if (pfd.empty())
+				std::this_thread::sleep_until(deadline);
+			else if (SSDP_POLL(pfd.data(), (unsigned long)pfd.size(), timeout) < 0)
+				throw std::system_error(last_error(), "poll");
+
+			/* resume waiters in order of waiting */
+			clock::time_point now = clock::now();
+			size_t p = 0;
+			for (waiter& w : waiters_) {
+				int result = -1;
+				for (int i = 0; i < w.count; ++i, ++p)
+					if (result == -1 && (pfd[p].revents & (POLLIN | POLLERR | POLLHUP)))
+						result = i;
+				w.done = result != -1 || w.deadline <= now;
+				if (w.done)
+					*w.result = result;
+			}
+			auto done = std::stable_partition(waiters_.begin(), waiters_.end(), [](const waiter& w) { return !w.done; });
+			for (auto it = done; it != waiters_.end(); ++it)
+				ready_.push_back(it->h);
+			waiters_.erase(done, waiters_.end());
+		}
+	}
+
+	/* co_await returns true if <s> is readable, false if <deadline> passed */
+	readable_awaiter readable(const socket& s, clock::time_point deadline = clock::time_point::max()) {
+		return readable_awaiter{ { *this, waiter{ { s.native(), socket::invalid }, 1, deadline, {}, nullptr, false } } };
+	}
+
+	/* co_await returns index of readable socket (0 or 1), -1 if <deadline> passed */
+	wait_awaiter readable(const socket& a, const socket& b, clock::time_point deadline = clock::time_point::max()) {
+		return wait_awaiter{ *this, waiter{ { a.native(), b.native() }, 2, deadline, {}, nullptr, false } };
+	}
+
+	/* co_await suspends until <deadline> */
+	wait_awaiter sleep_until(clock::time_point deadline) {
+		return wait_awaiter{ *this, waiter{ { socket::invalid, socket::invalid }, 0, deadline, {}, nullptr, false } };
+	}
+
+private:
+	friend struct task::promise_type;
+
+	/* called by finished task */
+	void forget(task::promise_type& p) noexcept {
+		auto last = tasks_.back();
+		last.promise().index = p.index;
+		tasks_[p.index] = last;
+		tasks_.pop_back();
+	}
+
+	/* destroys frames of unfinished tasks (and generators owned by them) */
+	void destroy_tasks() noexcept {
+		auto tasks = std::move(tasks_);
+		tasks_.clear();
+		waiters_.clear();
+		ready_.clear();
+		for (auto h : tasks)
+			h.destroy();
+	}
+
+	std::vector<std::coroutine_handle<task::promise_type>> tasks_;
+	std::vector<waiter> waiters_;
+	std::vector<std::coroutine_handle<>> ready_;
+	std::exception_ptr error_;
+};
+
+inline std::suspend_never task::promise_type::final_suspend() noexcept {
+	if (owner)
+		owner->forget(*this);
+	return {};
+}
+
+inline void task::promise_type::unhandled_exception() noexcept {
+	if (owner && !owner->error_)
+		owner->error_ = std::current_exception();
+}
+
+/* Lazy asynchronous sequence of T, consumed with co_await next() */
+template <class T>
+class async_generator {
+public:
+	struct promise_type {
+		const T* value = nullptr;
+		std::coroutine_handle<> consumer;
+		std::exception_ptr error;
+
+		/* suspends generator and resumes its consumer */
+		struct yield_awaiter {
+			bool await_ready() const noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+				return h.promise().consumer;
+			}
+			void await_resume() const noexcept {}
+		};
+
+		async_generator get_return_object() noexcept {
+			return async_generator(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		yield_awaiter final_suspend() noexcept {
+			value = nullptr;
+			return {};
+		}
+		yield_awaiter yield_value(const T& v) noexcept {
+			value = std::addressof(v);
+			return {};
+		}
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { error = std::current_exception(); }
+	};
+
+	struct next_awaiter {
+		std::coroutine_handle<promise_type> h;
+
+		bool await_ready() const noexcept { return !h || h.done(); }
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+			h.promise().consumer = consumer;
+			return h;
+		}
+		/* returns nullptr when generator is finished */
+		const T* await_resume() const {
+			if (!h)
+				return nullptr;
+			if (h.promise().error)
+				std::rethrow_exception(std::exchange(h.promise().error, nullptr));
+			return h.done() ? nullptr : h.promise().value;
+		}
+	};
+
+	async_generator(async_generator&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+	async_generator& operator=(async_generator&& other) noexcept {
+		std::swap(h_, other.h_);
+		return *this;
+	}
+	~async_generator() {
+		if (h_)
+			h_.destroy();
+	}
+
+	next_awaiter next() noexcept { return next_awaiter{ h_ }; }
+
+private:
+	explicit async_generator(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+
+	std::coroutine_handle<promise_type> h_;
+};
+
+/* Server found by scan() */
+struct scan_result {
+	std::string_view service_name;
+	std::string_view user_agent;
+	sockaddr_in server;
+};
+
+/* Datagram received by listen() on server socket */
+struct datagram {
+	std::span<const char> data;
+	sockaddr_in from;
+};
+
+/* Same as ssdp_scan(): sends ssdp:discover <retries> times every <discover_period> and yields responses.
+ * <client> must outlive the generator */
+inline async_generator<scan_result> scan(reactor& r, const socket& client, std::string service_type,
+	std::chrono::milliseconds discover_period, int retries) {
+	const ssdp_transport* t = ssdp_default_transport();
+	sockaddr_in ssdp_addr;
+	ssdp_address(&ssdp_addr);
+
+	char buffer[512];
+	char req_svc_type[128], req_svc_name[128], req_user_agent[128];
+	SSDP_REQUEST_TYPE req_type;
+	sockaddr_in from;
+
+	while (retries-- > 0) {
+		int size = ssdp_discover(service_type.c_str(), buffer, sizeof(buffer));
+		t->send(t->ctx, client.native(), buffer, size, &ssdp_addr);
+
+		clock::time_point deadline = clock::now() + discover_period;
+		while (co_await r.readable(client, deadline)) {
+			size = t->recv(t->ctx, client.native(), buffer, sizeof(buffer), &from);
+			if (size <= 0)
+				continue;
+			req_type = SSDP_RT_NONE;
+			req_svc_type[0] = req_svc_name[0] = req_user_agent[0] = '\0';
+			ssdp_parse_request(buffer, size, &req_type, req_svc_type, sizeof(req_svc_type),
+				req_svc_name, sizeof(req_svc_name), req_user_agent, sizeof(req_user_agent));
+			if (req_type == SSDP_RT_RESPONSE && std::strncmp(req_svc_type, service_type.c_str(), service_type.size()) == 0)
+				co_yield scan_result{ req_svc_name, req_user_agent, from };
+		}
+	}
+}
+
+/* Same as ssdp_listen(): responds to ssdp:discover on <ssdp_sock> and yields datagrams received on <server>.
+ * Finishes on receive error of <ssdp_sock>, destroy generator to stop listening earlier.
+ * <ssdp_sock> and <server> must outlive the generator */
+inline async_generator<datagram> listen(reactor& r, const socket& ssdp_sock, const socket& server,
+	std::string service_type, std::string service_name, std::string user_agent) {
+	const ssdp_transport* t = ssdp_default_transport();
+	char buffer[512];
+	sockaddr_in from;
+
+	for (;;) {
+		int readable = co_await r.readable(ssdp_sock, server);
+		if (readable == 0) {
+			int size = t->recv(t->ctx, ssdp_sock.native(), buffer, sizeof(buffer), &from);
+			if (size < 0)
+				co_return;
+			ssdp_listen_handle(t, server.native(), service_type.c_str(), service_type.size(),
+				service_name.c_str(), user_agent.c_str(), buffer, size, &from);
+		}
+		else if (readable == 1) {
+			int size = t->recv(t->ctx, server.native(), buffer, sizeof(buffer), &from);
+			if (size > 0)
+				co_yield datagram{ std::span<const char>(buffer, (size_t)size), from };
+		}
+	}
+}
+
+} // namespace ssdp
+
+#undef SSDP_POLL